@@ -0,0 +1,143 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fmt/format.h> // https://github.com/fmtlib/fmt
+
+#include <liburing/io_service_pool.hpp>
+
+// Cold-cache file serving: every thread reads all files with buffered reads, which the kernel
+// may punt to io-wq once the data isn't in page cache. Compares kernel default io-wq limits with
+// io_service::default_iowq_max_workers. Filesystems supporting async buffered reads (ext4, xfs...)
+// rarely punt reads, so FORCE_ASYNC=1 (the default) marks them IOSQE_ASYNC to emulate ones that do.
+
+enum {
+    BUF_SIZE = 64 * 1024,
+    QUEUE_DEPTH = 32,
+};
+
+struct stopwatch {
+    using clock = std::chrono::steady_clock;
+    clock::time_point start = clock::now();
+    double seconds() const {
+        return std::chrono::duration<double>(clock::now() - start).count();
+    }
+};
+
+// Count io-wq worker threads ( named iou-wrk-<tid> ) of this process
+static unsigned count_iowq_workers() {
+    unsigned result = 0;
+    DIR* dir = opendir("/proc/self/task");
+    if (!dir) return 0;
+    while (auto* entry = readdir(dir)) {
+        if (entry->d_name[0] == '.') continue;
+        char comm[32] = {};
+        int fd = open(fmt::format("/proc/self/task/{}/comm", entry->d_name).c_str(), O_RDONLY);
+        if (fd < 0) continue;
+        if (read(fd, comm, sizeof (comm) - 1) > 0 && std::string_view(comm).starts_with("iou-wrk")) ++result;
+        close(fd);
+    }
+    closedir(dir);
+    return result;
+}
+
+static void drop_cache(const std::vector<std::string>& files) {
+    for (auto& file : files) {
+        int fd = open(file.c_str(), O_RDONLY) | uio::panic_on_err("open", true);
+        fdatasync(fd);
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+}
+
+static uint8_t read_iflags = IOSQE_ASYNC;
+
+uio::task<> read_all(uio::io_service& service, const std::vector<std::string>& files, std::atomic<size_t>& bytes) {
+    using uio::task;
+
+    size_t next = 0;
+    auto worker = [&]() -> task<> {
+        std::vector<char> buf(BUF_SIZE);
+        while (next < files.size()) {
+            const auto& file = files[next++];
+            int fd = co_await service.openat(AT_FDCWD, file.c_str(), O_RDONLY, 0) | uio::panic_on_err("openat", false);
+            for (off_t offset = 0;; offset += BUF_SIZE) {
+                int r = co_await service.read(fd, buf.data(), BUF_SIZE, offset, read_iflags) | uio::panic_on_err("read", false);
+                if (r == 0) break;
+                bytes += size_t(r);
+            }
+            co_await service.close(fd);
+        }
+    };
+
+    std::vector<task<>> workers;
+    for (int i = 0; i < QUEUE_DEPTH; ++i) workers.push_back(worker());
+    for (auto& w : workers) co_await w;
+}
+
+static void run_case(const char* name, uio::io_service_pool& pool, const std::vector<std::string>& files) {
+    drop_cache(files);
+
+    std::atomic<size_t> bytes = 0;
+    std::atomic<bool> done = false;
+    unsigned peak_workers = 0;
+    std::thread monitor([&]() {
+        while (!done) {
+            peak_workers = std::max(peak_workers, count_iowq_workers());
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    });
+
+    stopwatch sw;
+    pool.run([&](uio::io_service& service, unsigned) {
+        return read_all(service, files, bytes);
+    });
+    auto elapsed = sw.seconds();
+    done = true;
+    monitor.join();
+
+    fmt::print("{:<24}{:>10.3f}s{:>12.1f} MiB/s{:>10} workers\n",
+        name, elapsed, double(bytes) / elapsed / (1 << 20), peak_workers);
+}
+
+int main(int argc, char* argv[]) {
+    using uio::panic_on_err;
+
+    if (argc < 2) {
+        fmt::print("Usage: {} <DIR> [NR_FILES=256] [FILE_SIZE_KB=1024] [NR_THREADS=0] [FORCE_ASYNC=1]\n", argv[0]);
+        return 1;
+    }
+
+    const std::string dir = argv[1];
+    const int nr_files = argc > 2 ? std::atoi(argv[2]) : 256;
+    const size_t file_size = (argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 1024) * 1024;
+    const unsigned nr_threads = argc > 4 ? unsigned(std::atoi(argv[4])) : 0;
+    if (argc > 5 && std::atoi(argv[5]) == 0) read_iflags = 0;
+
+    std::vector<std::string> files;
+    std::vector<char> data(file_size, 'x');
+    for (int i = 0; i < nr_files; ++i) {
+        auto& file = files.emplace_back(fmt::format("{}/iowq_bench_{}", dir, i));
+        int fd = open(file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644) | panic_on_err("open", true);
+        write(fd, data.data(), data.size()) | panic_on_err("write", true);
+        close(fd);
+    }
+
+    {
+        uio::io_service_pool pool(nr_threads);
+        pool.set_iowq_max_workers(0, 0);
+        run_case("kernel default limits:", pool, files);
+    }
+    {
+        uio::io_service_pool pool(nr_threads);
+        auto [bounded, unbounded] = uio::io_service::default_iowq_max_workers(pool.size());
+        run_case(fmt::format("bounded={}/ring:", bounded).c_str(), pool, files);
+    }
+
+    for (auto& file : files) unlink(file.c_str());
+}
@@ -2,6 +2,10 @@
 #include <functional>
 #include <system_error>
 #include <chrono>
+#include <thread>
+#include <algorithm>
+#include <bit>
+#include <sched.h>
 #include <sys/poll.h>
 #include <sys/timerfd.h>
 #include <sys/stat.h>
@@ -25,6 +29,22 @@
 #endif
 
 namespace uio {
+/** Counters describing how an io_service has been used
+ * @see io_service::stats
+ */
+struct io_service_stats {
+    /** Current number of SQ entries */
+    unsigned entries = 0;
+    /** SQ size the observed load asks for; equals `entries` when the current size looks right */
+    unsigned recommended_entries = 0;
+    /** Times io_uring_get_sqe_safe found the SQ full and had to flush it */
+    uint64_t sq_full = 0;
+    /** Run loop iterations that found CQEs held back by the kernel because the CQ was full */
+    uint64_t cq_overflow = 0;
+    /** Times the rings were resized with IORING_REGISTER_RESIZE_RINGS */
+    uint64_t resizes = 0;
+};
+
 class io_service {
 public:
     /** Init io_service / io_uring object
@@ -45,6 +65,8 @@ public:
         };
 
         io_uring_queue_init_params(entries, &ring, &p) | panic_on_err("queue_init_params", false);
+        stats_.entries = stats_.recommended_entries = ring.sq.ring_entries;
+        resize_min = resize_max = ring.sq.ring_entries;
 
         auto* probe = io_uring_get_probe_ring(&ring);
         on_scope_exit free_probe([=]() { io_uring_free_probe(probe); });
@@ -696,6 +718,7 @@ public:
             return sqe;
         } else {
             printf_if_verbose(__FILE__ ": SQ is full, flushing %u cqe(s)\n", cqe_count);
+            ++stats_.sq_full;
             io_uring_cq_advance(&ring, cqe_count);
             cqe_count = 0;
             io_uring_submit(&ring);
@@ -713,6 +736,7 @@ public:
     template <typename T, bool nothrow>
     T run(const task<T, nothrow>& t) noexcept(nothrow) {
         while (!t.done()) {
+            resize_window.peak_batch = std::max(resize_window.peak_batch, io_uring_sq_ready(&ring));
             io_uring_submit_and_wait(&ring, 1);
 
             io_uring_cqe *cqe;
@@ -728,11 +752,87 @@ public:
 
             io_uring_cq_advance(&ring, cqe_count);
             cqe_count = 0;
+
+            adapt_ring_size();
         }
 
         return t.get_result();
     }
 
+    /** Allow the rings to be resized automatically between min_entries and max_entries
+     *
+     * The SQ doubles (CQ follows) as soon as the SQ-full flush path is hit or CQEs overflow, and
+     * shrinks to twice the largest batch queued during a long streak of run loop iterations.
+     * Resizing requires a kernel with IORING_REGISTER_RESIZE_RINGS and a ring created with
+     * IORING_SETUP_DEFER_TASKRUN ( and thus IORING_SETUP_SINGLE_ISSUER ), without IORING_SETUP_SQPOLL.
+     * Otherwise the ring is left alone and the size it would have picked is reported in
+     * io_service_stats::recommended_entries.
+     * By default min_entries == max_entries == initial size, i.e. no resizing.
+     */
+    void set_resize_limits(unsigned min_entries, unsigned max_entries) noexcept {
+        resize_min = std::max(min_entries, 1u);
+        resize_max = std::max(max_entries, resize_min);
+    }
+
+    /** Get counters describing ring usage */
+    [[nodiscard]]
+    const io_service_stats& stats() const noexcept {
+        return stats_;
+    }
+
+private:
+    /** Called once per run loop iteration, when no CQE is being processed and no SQE is borrowed */
+    void adapt_ring_size() noexcept {
+        if (__builtin_expect(io_uring_cq_has_overflow(&ring), false)) {
+            ++stats_.cq_overflow;
+            ++resize_window.cq_overflow;
+        }
+
+        const unsigned entries = stats_.entries;
+        unsigned wanted;
+        if (__builtin_expect(stats_.sq_full != resize_window.last_sq_full || resize_window.cq_overflow, false)) {
+            wanted = std::min(entries * 2, MAX_RING_ENTRIES);
+        } else if (++resize_window.iterations >= RESIZE_WINDOW) {
+            // Keep twice the largest batch seen, so that a short burst doesn't immediately fill it up
+            wanted = std::min(std::bit_ceil(std::max(resize_window.peak_batch, 1u) * 2), entries);
+        } else {
+            return;
+        }
+        resize_window = { .last_sq_full = stats_.sq_full };
+        stats_.recommended_entries = wanted;
+
+        const unsigned target = std::clamp(wanted, resize_min, resize_max);
+        if (target == entries || !resizable()) return;
+
+        io_uring_params p = {
+            .sq_entries = target,
+            .cq_entries = target * 2,
+            .flags = IORING_SETUP_CQSIZE,
+        };
+        // Kernel copies pending SQEs and CQEs over; make sure nothing is left in liburing's local queue
+        io_uring_submit(&ring);
+        if (int ret = io_uring_resize_rings(&ring, &p); ret == 0) {
+            printf_if_verbose(__FILE__ ": rings resized from %u to %u entries\n", entries, target);
+            stats_.entries = ring.sq.ring_entries;
+            stats_.recommended_entries = stats_.entries;
+            ++stats_.resizes;
+        } else if (ret != -EOVERFLOW && ret != -EBUSY) {
+            // Not supported by this kernel; keep reporting recommendations only
+            printf_if_verbose(__FILE__ ": unable to resize rings: %d\n", ret);
+            resize_unsupported = true;
+        }
+    }
+
+    [[nodiscard]]
+    bool resizable() const noexcept {
+        return !resize_unsupported
+            && (ring.flags & IORING_SETUP_DEFER_TASKRUN)
+            && !(ring.flags & IORING_SETUP_SQPOLL);
+    }
+
+    static constexpr unsigned MAX_RING_ENTRIES = 32768;
+    static constexpr unsigned RESIZE_WINDOW = 4096;
+
 public:
     /** Register files for I/O
      * @param fds fds to register
@@ -779,6 +879,46 @@ public:
         return io_uring_unregister_buffers(&ring);
     }
 
+public:
+    /** Limit the number of io-wq workers the kernel may create for this ring
+     * @param bounded max workers for bounded work (regular files, openat, statx...); 0 keeps current value
+     * @param unbounded max workers for unbounded work (sockets, pipes...); 0 keeps current value
+     * @return previous limits as { bounded, unbounded }
+     * @note io-wq is per task, so this must be called from the thread that submits to this ring
+     * @see io_uring_register(2) IORING_REGISTER_IOWQ_MAX_WORKERS
+     */
+    std::pair<unsigned, unsigned> register_iowq_max_workers(unsigned bounded, unsigned unbounded) {
+        unsigned values[2] = { bounded, unbounded };
+        io_uring_register_iowq_max_workers(&ring, values) | panic_on_err("io_uring_register_iowq_max_workers", false);
+        return { values[0], values[1] };
+    }
+
+    /** Default io-wq limits for one of @p nr_rings rings sharing a worker pool via IORING_SETUP_ATTACH_WQ
+     * Bounded workers are split evenly across the rings so that their sum never exceeds the core
+     * count. Unbounded work may block forever (e.g. reading from a pipe), so it is left unchanged.
+     * @return { bounded, unbounded }, suitable for register_iowq_max_workers
+     */
+    [[nodiscard]]
+    static std::pair<unsigned, unsigned> default_iowq_max_workers(unsigned nr_rings) noexcept {
+        unsigned cores = std::max(std::thread::hardware_concurrency(), 1u);
+        return { std::max(cores / std::max(nr_rings, 1u), 1u), 0 };
+    }
+
+    /** Set CPU affinity of io-wq workers created for this ring
+     * @param mask CPUs the workers are allowed to run on
+     * @see io_uring_register(2) IORING_REGISTER_IOWQ_AFF
+     */
+    void register_iowq_aff(const cpu_set_t& mask) {
+        io_uring_register_iowq_aff(&ring, sizeof (mask), &mask) | panic_on_err("io_uring_register_iowq_aff", false);
+    }
+
+    /** Restore default CPU affinity of io-wq workers
+     * @see io_uring_register(2) IORING_UNREGISTER_IOWQ_AFF
+     */
+    int unregister_iowq_aff() noexcept {
+        return io_uring_unregister_iowq_aff(&ring);
+    }
+
 public:
     /** Return internal io_uring handle */
     [[nodiscard]]
@@ -790,6 +930,15 @@ private:
     io_uring ring;
     unsigned cqe_count = 0;
     bool probe_ops[IORING_OP_LAST] = {};
+    io_service_stats stats_;
+    unsigned resize_min, resize_max;
+    bool resize_unsupported = false;
+    struct {
+        unsigned iterations = 0;
+        unsigned peak_batch = 0;
+        uint64_t cq_overflow = 0;
+        uint64_t last_sq_full = 0;
+    } resize_window;
 };
 
 } // namespace uio
@@ -0,0 +1,138 @@
+#pragma once
+#include <thread>
+#include <vector>
+#include <future>
+#include <exception>
+#include <optional>
+#include <sched.h>
+#include <pthread.h>
+
+#include <liburing/io_service.hpp>
+
+namespace uio {
+/** A thread-per-core set of io_service instances
+ *
+ * Each thread owns exactly one ring. Ring 0 is created first, every other ring is created with
+ * IORING_SETUP_ATTACH_WQ so that all of them share one kernel async worker pool. Unless told
+ * otherwise, each ring caps its bounded io-wq workers with io_service::default_iowq_max_workers,
+ * so blocking-capable work (buffered file reads, openat, statx...) can't spawn hundreds of workers
+ * that fight the pinned threads for CPU.
+ */
+class io_service_pool {
+public:
+    /** Create a pool description; threads and rings are created by `run`
+     * @param nr_threads number of threads (and rings); 0 means one per usable CPU
+     * @param entries Maximum sqe can be gotten without submitting, per ring
+     * @param flags flags used to init every io_uring
+     */
+    explicit io_service_pool(unsigned nr_threads = 0, int entries = 64, uint32_t flags = 0)
+        : entries(entries)
+        , flags(flags) {
+        CPU_ZERO(&usable_cpus);
+        sched_getaffinity(0, sizeof (usable_cpus), &usable_cpus) | panic_on_err("sched_getaffinity", true);
+        nr_rings = nr_threads ? nr_threads : std::max(CPU_COUNT(&usable_cpus), 1);
+        iowq_limits = io_service::default_iowq_max_workers(nr_rings);
+    }
+
+    io_service_pool(const io_service_pool&) = delete;
+    io_service_pool& operator =(const io_service_pool&) = delete;
+
+    /** Number of threads (and rings) */
+    [[nodiscard]]
+    unsigned size() const noexcept {
+        return nr_rings;
+    }
+
+    /** Override per-ring io-wq limits
+     * @see io_service::register_iowq_max_workers; pass { 0, 0 } to keep kernel defaults
+     */
+    void set_iowq_max_workers(unsigned bounded, unsigned unbounded) noexcept {
+        iowq_limits = { bounded, unbounded };
+    }
+
+    /** Restrict io-wq workers of every ring to the given CPUs
+     * @see io_service::register_iowq_aff
+     */
+    void set_iowq_aff(const cpu_set_t& mask) noexcept {
+        iowq_aff = mask;
+    }
+
+    /** Whether thread i is pinned to the i-th usable CPU (default: true) */
+    void set_pin_threads(bool pin) noexcept {
+        pin_threads = pin;
+    }
+
+    /** Start one thread per ring, run `fn(service, index)` on each of them and wait for all
+     * @param fn callable returning a task<>; it's called on the thread owning the ring
+     * @throw the first exception thrown by any of the threads, after all of them are joined
+     */
+    template <typename Fn>
+    void run(Fn&& fn) {
+        std::promise<uint32_t> wq_promise;
+        std::shared_future<uint32_t> wq_fd = wq_promise.get_future().share();
+        std::vector<std::exception_ptr> errors(nr_rings);
+        std::vector<std::thread> threads;
+        threads.reserve(nr_rings);
+
+        for (unsigned i = 0; i < nr_rings; ++i) {
+            threads.emplace_back([&, i]() {
+                try {
+                    std::optional<io_service> service;
+                    if (i == 0) {
+                        // Other threads are waiting for ring 0; never leave them hanging
+                        try {
+                            if (pin_threads) pin_to_cpu(i);
+                            service.emplace(entries, flags);
+                        } catch (...) {
+                            wq_promise.set_exception(std::current_exception());
+                            throw;
+                        }
+                        wq_promise.set_value(uint32_t(service->get_handle().ring_fd));
+                    } else {
+                        if (pin_threads) pin_to_cpu(i);
+                        service.emplace(entries, flags | IORING_SETUP_ATTACH_WQ, wq_fd.get());
+                    }
+                    if (iowq_limits.first || iowq_limits.second) {
+                        service->register_iowq_max_workers(iowq_limits.first, iowq_limits.second);
+                    }
+                    if (iowq_aff) service->register_iowq_aff(*iowq_aff);
+
+                    service->run(fn(*service, i));
+                } catch (...) {
+                    errors[i] = std::current_exception();
+                }
+            });
+        }
+
+        for (auto& thread : threads) thread.join();
+        for (auto& error : errors) {
+            if (error) std::rethrow_exception(error);
+        }
+    }
+
+private:
+    void pin_to_cpu(unsigned index) const {
+        unsigned nth = index % unsigned(std::max(CPU_COUNT(&usable_cpus), 1));
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &usable_cpus) && nth-- == 0) {
+                cpu_set_t mask;
+                CPU_ZERO(&mask);
+                CPU_SET(cpu, &mask);
+                if (int err = pthread_setaffinity_np(pthread_self(), sizeof (mask), &mask)) {
+                    panic("pthread_setaffinity_np", err);
+                }
+                return;
+            }
+        }
+    }
+
+    int entries;
+    uint32_t flags;
+    unsigned nr_rings;
+    bool pin_threads = true;
+    cpu_set_t usable_cpus;
+    std::pair<unsigned, unsigned> iowq_limits;
+    std::optional<cpu_set_t> iowq_aff;
+};
+
+} // namespace uio
@@ -0,0 +1,30 @@
+#include <fmt/core.h>
+
+#include <liburing/io_service.hpp>
+
+int main() {
+    using uio::io_service;
+    using uio::task;
+
+    io_service service(8, IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN);
+    service.set_resize_limits(8, 256);
+
+    service.run([] (io_service& service) -> task<> {
+        // Queue far more NOPs than the SQ can hold to hit the SQ-full path
+        for (int round = 0; round < 4; ++round) {
+            std::vector<task<int>> nops;
+            for (int i = 0; i < 64; ++i) {
+                nops.push_back([&]() -> task<int> { co_return co_await service.yield(); }());
+            }
+            for (auto& nop : nops) co_await nop;
+        }
+    }(service));
+
+    auto& stats = service.stats();
+    fmt::print("entries: {}, recommended: {}, sq_full: {}, resizes: {}\n",
+        stats.entries, stats.recommended_entries, stats.sq_full, stats.resizes);
+
+    if (stats.sq_full == 0) uio::panic("SQ-full path never hit", EINVAL);
+    // Either the rings grew, or ( on kernels without IORING_REGISTER_RESIZE_RINGS ) a bigger size is recommended
+    if (stats.entries <= 8 && stats.recommended_entries <= 8) uio::panic("ring size never adapted", EINVAL);
+}